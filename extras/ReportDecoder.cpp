@@ -0,0 +1,29 @@
+// Host side decoder for MTkbd binary event records (SetReportMode(MTkbd::REPORT_BINARY)).
+// Build on the PC:  g++ -O2 -I../src ReportDecoder.cpp -o ReportDecoder
+// Run:              stty -F /dev/ttyUSB0 115200 raw && ./ReportDecoder < /dev/ttyUSB0
+
+#include <stdio.h>
+#include "MTkbdReport.h"
+
+int main()
+{
+    static const char *type_s[MTkbdReport::EVT_MAX] = {"NONE", "KEY", "PATTERN", "LONGPRESS"};
+    MTkbdReport decoder;
+    int ch;
+    while ((ch = getchar()) != EOF)
+    {
+        for (bool ready = decoder.Decode((uint8_t)ch); ready; ready = decoder.Next())
+        {
+            const MTkbdReport::Event &evt = decoder.GetEvent();
+            if (evt.type == MTkbdReport::EVT_PATTERN)
+                printf("%10u #%3u %-9s '%s'\n", evt.timestampMS, evt.seq, type_s[evt.type], evt.pattern);
+            else
+                printf("%10u #%3u %-9s KeyCode %u repeat %u duration %u ms\n",
+                       evt.timestampMS, evt.seq, type_s[evt.type], evt.keyCode, evt.repeat, evt.durationMS);
+        }
+        fflush(stdout);
+    }
+    fprintf(stderr, "crc errors %u, frame errors %u, lost records %u, skipped bytes %u\n",
+            decoder.GetCrcErrors(), decoder.GetFrameErrors(), decoder.GetLostRecords(), decoder.GetSkippedBytes());
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Minimal Arduino stand-in to build and run MTkbd on the PC (host tests in this folder only).
+// Pins, touch values and time are plain globals the tests set before each Loop().
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <array>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define F(s) (s)
+#define SOC_TOUCH_SENSOR_SUPPORTED 1
+
+class String
+{
+public:
+    String(const char *c = "") : s(c) {}
+    String(char c) : s(1, c) {}
+    const char *c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    String operator+(const String &o) const { return String((s + o.s).c_str()); }
+    friend String operator+(const char *a, const String &b) { return String(a) + b; }
+    bool operator==(const String &o) const { return s == o.s; }
+
+private:
+    std::string s;
+};
+
+extern uint8_t hostPin[256];     // digitalRead() level per pin
+extern uint32_t hostTouch[256];  // touchRead() value per pin
+extern int64_t hostMicros;       // esp_timer_get_time()
+extern bool hostQuiet;           // drop text output
+extern std::string hostOut;      // everything written to Serial
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t pin) { return hostPin[pin]; }
+inline uint32_t touchRead(uint8_t pin) { return hostTouch[pin]; }
+inline int64_t esp_timer_get_time() { return hostMicros; }
+
+class HostSerial
+{
+public:
+    size_t write(const uint8_t *buf, size_t len)
+    {
+        hostOut.append((const char *)buf, len);
+        return len;
+    }
+    void print(const char *s) { text(s); }
+    void print(int v) { text(std::to_string(v).c_str()); }
+    void println(const char *s = "")
+    {
+        text(s);
+        text("\r\n");
+    }
+    void println(int v) { println(std::to_string(v).c_str()); }
+    void println(const String &s) { println(s.c_str()); }
+    void printf(const char *fmt, ...)
+    {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        text(buf);
+    }
+
+private:
+    void text(const char *s)
+    {
+        if (!hostQuiet)
+            hostOut += s;
+    }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,319 @@
+// Differential test of the table driven Loop() against the frozen reference engine
+// (reference/MTkbdRef.*): both run in lockstep on the same recorded and random key
+// traces, every handled event must match. Also prints ns/scan of both engines.
+// Usage: DiffTest [random traces]
+
+#include "Arduino.h"
+#include "MTkbd.h"
+#include "HostTest.h"
+#include "reference/MTkbdRef.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static uint8_t pins[4] = {0, 2, 4, 36};
+
+typedef std::vector<uint8_t> trace_t; // raw keycode per ms
+
+// hold kc for ms, the first 8 ms bounce against the previous code
+static void hold(trace_t &t, uint8_t kc, int ms, std::mt19937 &rng, bool bounce = true)
+{
+    uint8_t prev = t.empty() ? 0 : t.back();
+    for (int i = 0; i < ms; i++)
+        t.push_back(bounce && i < 8 && (rng() & 1) ? prev : kc);
+}
+
+// hand written sequences, key 3 is the pattern key
+static trace_t recorded()
+{
+    std::mt19937 rng(0);
+    trace_t t;
+    hold(t, 0, 500, rng, false);
+    hold(t, 1, 120, rng); // click
+    hold(t, 0, 600, rng);
+    hold(t, 2, 100, rng); // double click
+    hold(t, 0, 150, rng);
+    hold(t, 2, 100, rng);
+    hold(t, 0, 600, rng);
+    for (int i = 0; i < 3; i++) // triple click
+    {
+        hold(t, 4, 90, rng);
+        hold(t, 0, i < 2 ? 120 : 600, rng);
+    }
+    hold(t, 8, 1700, rng); // long press
+    hold(t, 0, 600, rng);
+    hold(t, 5, 300, rng); // chord
+    hold(t, 0, 600, rng);
+    hold(t, 3, 3000, rng); // pattern start
+    hold(t, 0, 400, rng);
+    for (uint8_t kc : {1, 2, 4, 8, 8, 4, 2, 1})
+    {
+        hold(t, kc, 150, rng);
+        hold(t, 0, 250, rng);
+    }
+    hold(t, 3, 3000, rng); // pattern end
+    hold(t, 0, 600, rng);
+    hold(t, 0, 40000, rng, false);
+    return t;
+}
+
+static trace_t randomTrace(uint32_t seed, int events)
+{
+    std::mt19937 rng(seed);
+    trace_t t;
+    hold(t, 0, 200, rng, false);
+    for (int e = 0; e < events; e++)
+    {
+        int kind = rng() % 20;
+        uint8_t kc = 1 + rng() % 15;
+        if (kind < 8) // click
+        {
+            hold(t, kc, 60 + rng() % 200, rng);
+            hold(t, 0, 350 + rng() % 400, rng);
+        }
+        else if (kind < 10) // multi click
+        {
+            int n = 2 + rng() % 3;
+            for (int i = 0; i < n; i++)
+            {
+                hold(t, kc, 60 + rng() % 120, rng);
+                hold(t, 0, i + 1 < n ? 80 + rng() % 150 : 500, rng);
+            }
+        }
+        else if (kind < 12) // long press
+        {
+            hold(t, kc, 600 + rng() % 2500, rng);
+            hold(t, 0, 500, rng);
+        }
+        else if (kind < 14) // chord with staggered edges
+        {
+            uint8_t a = 1 << (rng() % 4), b = 1 << (rng() % 4);
+            hold(t, a, 20 + rng() % 80, rng);
+            hold(t, a | b, 100 + rng() % 300, rng);
+            hold(t, b, rng() % 90, rng);
+            hold(t, 0, 500, rng);
+        }
+        else if (kind < 16) // pattern entry, ended by the pattern key or left to time out
+        {
+            hold(t, 3, 2600 + rng() % 2300, rng);
+            hold(t, 0, 300, rng);
+            for (int n = rng() % 10; n; n--)
+            {
+                hold(t, 1 + rng() % 15, 60 + rng() % 300, rng);
+                hold(t, 0, 100 + rng() % 400, rng);
+            }
+            if (rng() % 3)
+            {
+                hold(t, 3, 2600 + rng() % 2300, rng);
+                hold(t, 0, 500, rng);
+            }
+            else
+                hold(t, 0, 200 + rng() % 40000, rng, false);
+        }
+        else if (kind < 18) // glitches around bounce time
+        {
+            hold(t, kc, 1 + rng() % 60, rng, false);
+            hold(t, 0, 100 + rng() % 500, rng, false);
+        }
+        else // idle
+            hold(t, 0, rng() % 5000, rng, false);
+    }
+    hold(t, 0, 40000, rng, false);
+    return t;
+}
+
+struct config_t
+{
+    uint32_t patternTimeout;
+    bool waitHandled;
+    uint32_t handledDelayMS; // Handled() this long after Available()
+    bool beginInPassword;    // StartPasswordMode() at 100 ms, Begin() again at 150 ms, in the idle start of a trace
+};
+
+// one engine on a trace, shares the pins with the other engine
+template <class KBD>
+struct Runner
+{
+    KBD kbd;
+    std::vector<std::string> events;
+    bool pending = false;
+    size_t readyMS = 0;
+
+    Runner(const config_t &cfg)
+    {
+        begin(cfg);
+    }
+
+    void begin(const config_t &cfg)
+    {
+        kbd.Begin(true, 4, pins);
+        kbd.SetPatternKeyCode(3);
+        kbd.SetPatternTimeout(cfg.patternTimeout);
+        kbd.SetWaitHandled(cfg.waitHandled);
+    }
+
+    void scan(size_t ms, const config_t &cfg)
+    {
+        if (cfg.beginInPassword && ms == 100)
+            kbd.StartPasswordMode(10);
+        if (cfg.beginInPassword && ms == 150)
+            begin(cfg);
+        kbd.Loop();
+        if (kbd.Available() && !pending)
+        {
+            pending = true;
+            readyMS = ms;
+        }
+        if (pending && ms >= readyMS + cfg.handledDelayMS)
+        {
+            char line[96];
+            snprintf(line, sizeof(line), "%zu %s kc=%u rep=%u dur=%u pat='%s'", ms, kbd.IsPattern() ? "P" : "K",
+                     kbd.KeyCode(), kbd.Repeat(), kbd.Duration(), kbd.IsPattern() ? kbd.Pattern().c_str() : "");
+            events.push_back(line);
+            pending = false;
+            kbd.Handled();
+        }
+    }
+};
+
+static void setPins(uint8_t code)
+{
+    for (uint8_t bit = 0; bit < 4; bit++)
+        hostPin[pins[bit]] = !(code >> bit & 1);
+}
+
+// run both engines on all traces, return number of traces with different events
+static int compare(const std::vector<trace_t> &traces, const config_t &cfg, long &events, bool show)
+{
+    int differ = 0;
+    events = 0;
+    for (size_t idx = 0; idx < traces.size(); idx++)
+    {
+        const trace_t &t = traces[idx];
+        setPins(0);
+        Runner<MTkbd> now(cfg);
+        Runner<MTkbdRef> ref(cfg);
+        for (size_t ms = 0; ms < t.size(); ms++)
+        {
+            setPins(t[ms]);
+            hostMicros = (int64_t)ms * 1000;
+            now.scan(ms, cfg);
+            ref.scan(ms, cfg);
+        }
+        events += now.events.size();
+        if (now.events == ref.events)
+            continue;
+        if (show && differ == 0)
+        {
+            size_t pos = 0;
+            while (pos < now.events.size() && pos < ref.events.size() && now.events[pos] == ref.events[pos])
+                pos++;
+            printf("     trace %zu, first difference at event %zu\n       new: %s\n       ref: %s\n", idx, pos,
+                   pos < now.events.size() ? now.events[pos].c_str() : "-",
+                   pos < ref.events.size() ? ref.events[pos].c_str() : "-");
+        }
+        differ++;
+    }
+    return differ;
+}
+
+// without SetWaitHandled(true) a press drops the waiting key event, the newer event replaces it
+static void replaceWaitingEvent()
+{
+    std::mt19937 rng(0);
+    trace_t t;
+    hold(t, 0, 200, rng, false);
+    hold(t, 1, 100, rng); // event key 1, not handled
+    hold(t, 0, 600, rng);
+    hold(t, 2, 100, rng); // drops it
+    hold(t, 0, 600, rng);
+    setPins(0);
+    MTkbd kbd;
+    kbd.Begin(true, 4, pins);
+    bool first = false, droppedWhilePressed = false;
+    for (size_t ms = 0; ms < t.size(); ms++)
+    {
+        setPins(t[ms]);
+        hostMicros = (int64_t)ms * 1000;
+        kbd.Loop();
+        first |= kbd.Available() && kbd.KeyCode() == 1;
+        droppedWhilePressed |= first && t[ms] == 2 && !kbd.Available();
+    }
+    check(first && droppedWhilePressed && kbd.Available() && kbd.KeyCode() == 2 && kbd.Duration() > 90,
+          "no wait handled: newer key event replaces the waiting one");
+}
+
+template <class KBD>
+static double nsPerScan(const trace_t &t)
+{
+    setPins(0);
+    KBD kbd;
+    kbd.Begin(true, 4, pins);
+    kbd.SetPatternKeyCode(3);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t ms = 0; ms < t.size(); ms++)
+    {
+        setPins(t[ms]);
+        hostMicros = (int64_t)ms * 1000;
+        kbd.Loop();
+        if (kbd.Available())
+            kbd.Handled();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / t.size();
+}
+
+int main(int argc, char **argv)
+{
+    hostQuiet = true;
+    int randomTraces = argc > 1 ? atoi(argv[1]) : 200;
+    std::vector<trace_t> traces = {recorded()};
+    for (int seed = 1; seed <= randomTraces; seed++)
+        traces.push_back(randomTrace(seed, 60));
+
+    // the reference ends pattern mode at once when uptime is above the pattern timeout,
+    // a timeout that never expires hides that known bug, everything else must match
+    long events;
+    char what[96];
+    int differ = compare(traces, {UINT32_MAX, false, 0, false}, events, true);
+    snprintf(what, sizeof(what), "%zu traces, %ld events, Handled() at once: same events", traces.size(), events);
+    check(differ == 0, what);
+    differ = compare(traces, {UINT32_MAX, true, 700, false}, events, true);
+    snprintf(what, sizeof(what), "%zu traces, %ld events, wait handled, Handled() after 700 ms: same events",
+             traces.size(), events);
+    check(differ == 0, what);
+    differ = compare(traces, {UINT32_MAX, false, 0, true}, events, true);
+    snprintf(what, sizeof(what), "%zu traces, %ld events, Begin() during password mode: same events",
+             traces.size(), events);
+    check(differ == 0, what);
+
+    replaceWaitingEvent();
+
+    // expected differences: the fixed pattern timeout; without SetWaitHandled(true) the reference keeps
+    // Available() while a newer press changes KeyCode() / Duration(), also of a waiting pattern
+    differ = compare(traces, {30000, false, 0, false}, events, false);
+    printf("     default pattern timeout: %d of %zu traces differ (expected, pattern timeout fix)\n", differ,
+           traces.size());
+    differ = compare(traces, {UINT32_MAX, false, 700, false}, events, false);
+    printf("     Handled() after 700 ms: %d of %zu traces differ (expected, newer press drops the waiting event)\n",
+           differ, traces.size());
+
+    trace_t bench;
+    for (int seed = 1; seed <= 20; seed++)
+    {
+        trace_t t = randomTrace(seed, 60);
+        bench.insert(bench.end(), t.begin(), t.end());
+    }
+    // best of alternating rounds, the same work only when built with MTKBD_SNAPSHOT 0 (make test runs both)
+    double now = 1e9, ref = 1e9;
+    for (int round = 0; round < 5; round++)
+    {
+        now = std::min(now, nsPerScan<MTkbd>(bench));
+        ref = std::min(ref, nsPerScan<MTkbdRef>(bench));
+    }
+    printf("     %zu scans: table driven %.1f ns/scan, reference %.1f ns/scan (%s)\n", bench.size(), now, ref,
+           MTKBD_SNAPSHOT ? "table driven also publishes Snapshot(), reference has none" : "both without Snapshot()");
+    return HostTestResult();
+}
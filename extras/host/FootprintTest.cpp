@@ -0,0 +1,96 @@
+// RAM per keyboard: instance size, heap blocks per instance, no heap growth while running
+// and nothing left after destruction.
+
+#include "Arduino.h"
+#include "MTkbd.h"
+#include "HostTest.h"
+#include <new>
+#include <stdlib.h>
+
+static size_t allocs = 0; // operator new calls
+static size_t live = 0;   // bytes allocated and not freed
+
+// size kept in front of each block to count frees
+static void *allocate(size_t n)
+{
+    allocs++;
+    live += n;
+    max_align_t *p = (max_align_t *)malloc(sizeof(max_align_t) + n);
+    *(size_t *)p = n;
+    return p + 1;
+}
+
+static void release(void *ptr)
+{
+    if (!ptr)
+        return;
+    max_align_t *p = (max_align_t *)ptr - 1;
+    live -= *(size_t *)p;
+    free(p);
+}
+
+void *operator new(size_t n) { return allocate(n); }
+void *operator new[](size_t n) { return allocate(n); }
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+
+static uint8_t pins[4] = {0, 2, 4, 36};
+
+// click key 1 once, about 700 ms of scans
+static void click(MTkbd &kbd, int64_t &ms)
+{
+    for (int i = 0; i < 700; i++, ms++)
+    {
+        hostPin[pins[0]] = i < 100 ? LOW : HIGH;
+        hostMicros = ms * 1000;
+        kbd.Loop();
+        if (kbd.Available())
+            kbd.Handled();
+    }
+}
+
+int main()
+{
+    hostQuiet = true;
+    hostOut.reserve(1 << 16); // binary records go to hostOut, keep its growth out of the count
+    for (uint8_t pin : pins)
+        hostPin[pin] = HIGH;
+
+    size_t allocs0 = allocs, live0 = live;
+    MTkbd *kbd = new MTkbd();
+    kbd->Begin(true, 4, pins);
+    size_t blocks = allocs - allocs0, bytes = live - live0;
+    printf("     sizeof(MTkbd) %zu, per instance %zu bytes in %zu blocks (object + pattern buffer)\n", sizeof(MTkbd),
+           bytes, blocks);
+    check(blocks == 2 && bytes == sizeof(MTkbd) + 9, "one instance is the object and the pattern buffer");
+
+    allocs0 = allocs;
+    int64_t ms = 0;
+    for (int i = 0; i < 100; i++)
+        kbd->Handled();
+    for (int i = 0; i < 100; i++)
+    {
+        kbd->StartPasswordMode(1);
+        kbd->Handled();
+    }
+    for (int i = 0; i < 20; i++)
+        click(*kbd, ms);
+    check(allocs == allocs0 && live - live0 == bytes, "no heap use by Handled(), StartPasswordMode() and Loop()");
+
+    kbd->SetReportMode(MTkbd::REPORT_BINARY);
+    click(*kbd, ms);
+    size_t reportBlocks = allocs - allocs0;
+    allocs0 = allocs;
+    for (int i = 0; i < 20; i++)
+        click(*kbd, ms);
+    check(reportBlocks == 1 && allocs == allocs0, "binary report buffer allocated once");
+
+    kbd->BeginTouch(4, pins);
+    kbd->Begin(true, 4, pins);
+    kbd->BeginTouch(4, pins);
+    delete kbd;
+    check(live == live0, "nothing left after delete, also after Begin() / BeginTouch() switches");
+    return HostTestResult();
+}
@@ -0,0 +1,8 @@
+#include "Arduino.h"
+
+uint8_t hostPin[256];
+uint32_t hostTouch[256];
+int64_t hostMicros = 0;
+bool hostQuiet = false;
+std::string hostOut;
+HostSerial Serial;
@@ -0,0 +1,19 @@
+// Shared pass/fail reporting of the host tests, main() returns HostTestResult().
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+static int hostFailures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+        hostFailures++;
+}
+
+static int HostTestResult() { return hostFailures ? 1 : 0; }
+
+#endif
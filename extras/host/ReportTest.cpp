@@ -0,0 +1,238 @@
+// Binary report decoder: clean stream, corrupted LEN, random bit errors and a
+// stream produced by MTkbd itself.
+
+#include "Arduino.h"
+#include "MTkbd.h"
+#include "HostTest.h"
+#include <random>
+#include <vector>
+
+// KEY, PATTERN, KEY, ... with seq 0..count-1
+static std::vector<uint8_t> encode(int count)
+{
+    std::vector<uint8_t> out;
+    uint8_t buf[MTKBD_REPORT_OVERHEAD + 255];
+    for (int i = 0; i < count; i++)
+    {
+        size_t n = i % 2
+                       ? MTkbdReport::Encode(buf, sizeof(buf), i, MTkbdReport::EVT_PATTERN, 0, 0, 0, i * 10, "1a2b3c", 6)
+                       : MTkbdReport::Encode(buf, sizeof(buf), i, MTkbdReport::EVT_KEY, 1 + i % 4, 1, 120, i * 10);
+        out.insert(out.end(), buf, buf + n);
+    }
+    return out;
+}
+
+static std::vector<MTkbdReport::Event> decode(MTkbdReport &decoder, const std::vector<uint8_t> &stream)
+{
+    std::vector<MTkbdReport::Event> events;
+    for (uint8_t b : stream)
+        for (bool ready = decoder.Decode(b); ready; ready = decoder.Next())
+            events.push_back(decoder.GetEvent());
+    return events;
+}
+
+static void clean()
+{
+    MTkbdReport decoder;
+    auto events = decode(decoder, encode(100));
+    bool same = events.size() == 100;
+    for (size_t i = 0; same && i < events.size(); i++)
+        same = events[i].seq == i && events[i].timestampMS == i * 10 &&
+               events[i].type == (i % 2 ? MTkbdReport::EVT_PATTERN : MTkbdReport::EVT_KEY);
+    check(same && decoder.GetCrcErrors() + decoder.GetFrameErrors() + decoder.GetSkippedBytes() == 0,
+          "clean stream decodes every record");
+}
+
+// broken LEN of the first record must not swallow the records behind it
+static void brokenLen()
+{
+    for (uint8_t len : {250, 13, 30, 255})
+    {
+        auto stream = encode(3);
+        stream[1] = len;
+        MTkbdReport decoder;
+        auto events = decode(decoder, stream);
+        char what[80];
+        snprintf(what, sizeof(what), "first LEN %u: records 1 and 2 recovered", len);
+        check(events.size() == 2 && events[0].seq == 1 && events[1].seq == 2 &&
+                  decoder.GetCrcErrors() + decoder.GetFrameErrors() >= 1,
+              what);
+    }
+    // pattern record with a longer LEN
+    auto stream = encode(4);
+    size_t second = stream[1] + MTKBD_REPORT_OVERHEAD;
+    stream[second + 1] += 2;
+    MTkbdReport decoder;
+    auto events = decode(decoder, stream);
+    check(events.size() == 3 && events[1].seq == 2 && events[2].seq == 3 &&
+              decoder.GetCrcErrors() + decoder.GetFrameErrors() == 1,
+          "pattern LEN +2: following records recovered");
+}
+
+// flip random bits, nothing may decode wrong and intact records must come through
+static void bitErrors()
+{
+    std::mt19937 rng(7);
+    int lostIntact = 0, wrong = 0;
+    for (int run = 0; run < 2000; run++)
+    {
+        auto ref = encode(20);
+        auto stream = ref;
+        std::vector<bool> hit(20, false);
+        for (int flips = 1 + run % 3; flips; flips--)
+        {
+            size_t pos = rng() % stream.size();
+            stream[pos] ^= 1 << (rng() % 8);
+            // record index of pos
+            size_t start = 0;
+            for (int i = 0; i < 20; i++)
+            {
+                size_t n = ref[start + 1] + MTKBD_REPORT_OVERHEAD;
+                if (pos < start + n)
+                {
+                    hit[i] = true;
+                    break;
+                }
+                start += n;
+            }
+        }
+        MTkbdReport decoder;
+        std::vector<bool> seen(20, false);
+        for (auto &evt : decode(decoder, stream))
+        {
+            if (evt.seq >= 20 || evt.timestampMS != evt.seq * 10u)
+                wrong++;
+            else
+                seen[evt.seq] = true;
+        }
+        for (int i = 0; i < 20; i++)
+            if (!hit[i] && !seen[i])
+                lostIntact++;
+    }
+    printf("     intact records lost %d, wrong records %d\n", lostIntact, wrong);
+    check(wrong == 0, "bit errors: no wrong records");
+    check(lostIntact == 0, "bit errors: intact records all decoded");
+}
+
+// MTkbd in binary mode, key 2 clicked twice, then a password entry; no text may mix in
+static void fromLibrary()
+{
+    uint8_t pins[4] = {1, 2, 3, 4};
+    for (uint8_t pin : pins)
+        hostPin[pin] = HIGH;
+    hostOut.clear();
+    MTkbd kbd;
+    kbd.Begin(true, 4, pins);
+    kbd.SetReportMode(MTkbd::REPORT_BINARY);
+    for (int i = 0; i < 4000; i++)
+    {
+        hostMicros = i * 1000LL;
+        hostPin[2] = (i > 100 && i < 200) || (i > 1500 && i < 1600) ? LOW : HIGH;
+        if (i == 2000)
+            kbd.StartPasswordMode(1);
+        kbd.Loop();
+        if (kbd.Available())
+            kbd.Handled();
+    }
+    MTkbdReport decoder;
+    auto events = decode(decoder, std::vector<uint8_t>(hostOut.begin(), hostOut.end()));
+    check(events.size() == 3 && events[2].type == MTkbdReport::EVT_PATTERN && events[0].type == MTkbdReport::EVT_KEY && events[0].keyCode == 2 &&
+              events[1].keyCode == 2 && decoder.GetSkippedBytes() == 0,
+          "records written by MTkbd decode");
+}
+
+// text lines vs binary records on a 115200 baud line (11520 bytes/s at 10 bits per byte):
+// the same random clicks, double clicks, long presses and passwords in both modes
+static void throughput()
+{
+    uint8_t pins[4] = {1, 2, 3, 4};
+    long events[MTkbd::REPORT_MAX];
+    double bytesPerEvent[MTkbd::REPORT_MAX];
+    for (int mode = 0; mode < MTkbd::REPORT_MAX; mode++)
+    {
+        for (uint8_t pin : pins)
+            hostPin[pin] = HIGH;
+        hostOut.clear();
+        MTkbd kbd;
+        kbd.Begin(true, 4, pins);
+        kbd.SetReportMode((MTkbd::report_e)mode);
+        std::mt19937 rng(11);
+        int64_t ms = 0;
+        events[mode] = 0;
+        // press code for pressMS, then release for releaseMS
+        auto key = [&](uint8_t code, int pressMS, int releaseMS)
+        {
+            for (int i = 0; i < pressMS + releaseMS; i++, ms++)
+            {
+                for (uint8_t bit = 0; bit < 4; bit++)
+                    hostPin[pins[bit]] = i < pressMS && (code >> bit & 1) ? LOW : HIGH;
+                hostMicros = ms * 1000;
+                kbd.Loop();
+                if (kbd.Available())
+                {
+                    kbd.Handled();
+                    events[mode]++;
+                }
+            }
+        };
+        for (int action = 0; action < 3000; action++)
+        {
+            uint8_t code = 1 << rng() % 4;
+            switch (rng() % 4)
+            {
+            case 0: // click
+                key(code, 80 + rng() % 100, 500);
+                break;
+            case 1: // double click
+                key(code, 80, 150);
+                key(code, 80, 500);
+                break;
+            case 2: // long press, info every 500 ms
+                key(code, 1000 + rng() % 2000, 500);
+                break;
+            default: // password of 4 keys, ends by timeout
+                kbd.StartPasswordMode(1);
+                for (int n = 0; n < 4; n++)
+                    key(1 << rng() % 4, 100, 200);
+                key(0, 0, 1500);
+            }
+        }
+        bytesPerEvent[mode] = (double)hostOut.size() / events[mode];
+        printf("     %-6s %7zu bytes, %ld events, %5.1f bytes/event, %4.0f events/s at 115200 baud\n",
+               mode == MTkbd::REPORT_TEXT ? "text" : "binary", hostOut.size(), events[mode], bytesPerEvent[mode],
+               11520 / bytesPerEvent[mode]);
+    }
+    MTkbdReport decoder;
+    auto records = decode(decoder, std::vector<uint8_t>(hostOut.begin(), hostOut.end()));
+    long handled = 0;
+    for (auto &evt : records)
+        handled += evt.type != MTkbdReport::EVT_LONGPRESS;
+    printf("     binary %zu records (%zu long press info), %.1f bytes/record\n", records.size(),
+           records.size() - handled, (double)hostOut.size() / records.size());
+    check(events[MTkbd::REPORT_TEXT] == events[MTkbd::REPORT_BINARY] && handled == events[MTkbd::REPORT_BINARY] &&
+              decoder.GetSkippedBytes() == 0,
+          "text and binary run see the same events, every binary one decodes");
+    check(bytesPerEvent[MTkbd::REPORT_BINARY] < bytesPerEvent[MTkbd::REPORT_TEXT], "binary needs fewer bytes per event");
+}
+
+// Begin() errors are info lines, not part of a binary stream
+static void beginErrors()
+{
+    uint8_t duplicate[2] = {1, 1};
+    hostOut.clear();
+    MTkbd kbd;
+    kbd.SetReportMode(MTkbd::REPORT_BINARY);
+    bool ok = kbd.Begin(true, 0, duplicate) || kbd.Begin(true, 2, duplicate) || kbd.BeginTouch(2, duplicate);
+    check(!ok && hostOut.empty(), "Begin() errors stay out of binary mode");
+}
+
+int main()
+{
+    clean();
+    brokenLen();
+    bitErrors();
+    fromLibrary();
+    throughput();
+    beginErrors();
+    return HostTestResult();
+}
@@ -0,0 +1,176 @@
+// Snapshot() and Handled(seq) with the writer and the reader on different threads.
+// Run with 'make tsan' to have ThreadSanitizer watch the same code.
+// Usage: SnapshotStressTest [seconds per part]
+
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "Arduino.h"
+#include "MTkbd.h"
+#include "HostTest.h"
+
+// friend of MTkbd: publish an event with every field derived from n
+struct MTkbdTest
+{
+    static void publish(MTkbd &kbd, uint32_t n)
+    {
+        kbd._eventSeq = n;
+        kbd._durationMS = ~n;
+        kbd._keyCode = n & 0xFF;
+        kbd._repeatNr = (n >> 8) & 0x7F;
+        kbd._keyCodeReady = n & 1;
+        snprintf(kbd._pattern, kbd._maxPatternLength + 1, "%08x", n);
+        kbd._snapDirty = true;
+        kbd.publish();
+    }
+};
+
+// every field of a published event is derived from one counter, a snapshot mixing two publishes shows
+static void torn(double seconds)
+{
+    static MTkbd kbd;
+    std::atomic<bool> stop{false};
+    long writes = 0;
+    std::thread writer([&]
+                       {
+        for (uint32_t n = 1; !stop; n++)
+        {
+            MTkbdTest::publish(kbd, n);
+            writes++;
+        } });
+
+    long reads = 0, bad = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        MTkbd::event_t evt = kbd.Snapshot();
+        reads++;
+        uint32_t n = evt.seq;
+        if (n == 0)
+            continue;
+        char pattern[9];
+        snprintf(pattern, sizeof(pattern), "%08x", n);
+        uint8_t repeat = (n >> 8) & 0x7F;
+        bad += evt.durationMS != ~n || evt.keyCode != (n & 0xFF) || evt.repeat != (repeat ? repeat + 1 : 0) ||
+               evt.available != (bool)(n & 1) || strcmp(pattern, evt.pattern) != 0;
+    }
+    stop = true;
+    writer.join();
+    printf("     writes %ld, snapshots %ld, torn %ld\n", writes, reads, bad);
+    check(reads > 0 && writes > 0 && bad == 0, "no torn snapshot");
+}
+
+// after every Loop() the snapshot equals the accessors, publish() skips only unchanged events
+static void followsLoop()
+{
+    uint8_t pins[4] = {0, 2, 4, 36};
+    for (uint8_t pin : pins)
+        hostPin[pin] = HIGH;
+    MTkbd kbd;
+    kbd.Begin(true, 4, pins);
+    kbd.SetPatternKeyCode(3);
+    kbd.SetPatternMS(300, 900);
+    kbd.SetMaxPatternLength(MTKBD_SNAPSHOT_PATTERN + 8); // long patterns are cut in the snapshot
+    uint32_t rng = 7;
+    long loops = 0, bad = 0, cut = 0;
+    for (int64_t ms = 0; ms < 600000;)
+    {
+        rng = rng * 1103515245 + 12345;
+        uint8_t code = (rng >> 16) % 32;
+        if (code > 15)
+            code = 0;
+        for (uint8_t bit = 0; bit < 4; bit++)
+            hostPin[pins[bit]] = !(code >> bit & 1);
+        for (int scan = 1 + (rng >> 8) % 400; scan; scan--)
+        {
+            hostMicros = ms++ * 1000;
+            kbd.Loop();
+            loops++;
+            MTkbd::event_t evt = kbd.Snapshot();
+            bad += evt.keyCode != kbd.KeyCode() || evt.repeat != kbd.Repeat() || evt.durationMS != kbd.Duration() ||
+                   evt.available != kbd.Available() || evt.isPattern != kbd.IsPattern() ||
+                   evt.patternLength != kbd.Pattern().length() ||
+                   strncmp(evt.pattern, kbd.Pattern().c_str(), MTKBD_SNAPSHOT_PATTERN) != 0;
+            cut += evt.patternLength > strlen(evt.pattern);
+            if (kbd.Available() && (rng & 0x300) == 0)
+                kbd.Handled();
+            if ((rng & 0xFFF00) == 0x12300)
+                kbd.StartPasswordMode(2);
+        }
+    }
+    printf("     loops %ld, snapshots not equal to the accessors %ld, with cut pattern %ld\n", loops, bad, cut);
+    check(bad == 0, "snapshot follows every Loop()");
+    check(cut > 0, "cut pattern shows in patternLength");
+}
+
+// Loop() on one thread with random keys, the reader acknowledges every event with Handled(seq).
+// With SetWaitHandled(true) events wait for it, so every serial must be seen and handled exactly once,
+// without it newer events replace unhandled ones and serials only have to grow.
+static void handledFromReader(double seconds, bool waitHandled)
+{
+    uint8_t pins[4] = {0, 2, 4, 36};
+    for (uint8_t pin : pins)
+        hostPin[pin] = HIGH;
+    MTkbd kbd;
+    kbd.Begin(true, 4, pins);
+    kbd.SetBounceMS(0);
+    kbd.SetDoubleClickMS(2);
+    kbd.SetWaitHandled(waitHandled);
+    std::atomic<bool> stop{false};
+    std::atomic<long> loops{0};
+    std::thread writer([&]
+                       {
+        uint32_t rng = 1;
+        for (int64_t ms = 0; !stop;)
+        {
+            rng = rng * 1103515245 + 12345;
+            uint8_t code = (rng >> 16) % 32; // released about half the time
+            if (code > 15)
+                code = 0;
+            for (uint8_t bit = 0; bit < 4; bit++)
+                hostPin[pins[bit]] = !(code >> bit & 1);
+            for (int scan = 1 + (rng >> 8) % 7; scan; scan--)
+            {
+                hostMicros = ms++ * 1000;
+                kbd.Loop();
+                loops++;
+            }
+        } });
+
+    long handled = 0, order = 0, empty = 0;
+    uint32_t last = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < end)
+    {
+        MTkbd::event_t evt = kbd.Snapshot();
+        if (!evt.available || evt.seq == last)
+        {
+            std::this_thread::yield(); // let Loop() run on single core hosts
+            continue;
+        }
+        order += evt.seq < last; // serials only grow
+        empty += evt.keyCode == 0 && !evt.isPattern;
+        last = evt.seq;
+        kbd.Handled(evt.seq);
+        handled++;
+    }
+    stop = true;
+    writer.join();
+    printf("     wait handled %d: loops %ld, events handled %ld, last serial %u, out of order %ld, empty %ld\n",
+           waitHandled, loops.load(), handled, last, order, empty);
+    check(handled > 10 && (!waitHandled || (uint32_t)handled == last) && order == 0 && empty == 0,
+          waitHandled ? "Handled(seq) from reader, SetWaitHandled(true)" : "Handled(seq) from reader");
+}
+
+int main(int argc, char **argv)
+{
+    hostQuiet = true;
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    followsLoop();
+    torn(seconds);
+    handledFromReader(seconds, true);
+    handledFromReader(seconds, false);
+    return HostTestResult();
+}
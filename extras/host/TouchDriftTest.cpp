@@ -0,0 +1,185 @@
+// Touch backend under slow baseline drift, drift steps and sensor noise, built for both touch directions.
+// Pass: every touch detected on the right pad, no false presses, and
+// Begin() after BeginTouch() reads the digital pins again.
+
+#include "Arduino.h"
+#include "MTkbd.h"
+#include "HostTest.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// 2000 s at 1 ms scans, ~15% drift, noise sigma 6 counts, a 400 ms touch on pad 2 every 200 s
+static void driftAndNoise(bool rising)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 6.0);
+    uint8_t pins[4] = {4, 12, 13, 14};
+    for (uint8_t pin : pins)
+        hostTouch[pin] = 800;
+
+    MTkbd kbd;
+    kbd.BeginTouch(4, pins);
+    const int scans = 2000000;
+    int presses = 0, falsePresses = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < scans; i++)
+    {
+        hostMicros = (int64_t)i * 1000;
+        double drift = 120.0 * std::sin(i / 300000.0) - 0.00005 * i;
+        bool touch = i % 200000 > 100000 && i % 200000 < 100400;
+        for (uint8_t p = 0; p < 4; p++)
+        {
+            double v = 800 + drift + noise(rng);
+            if (touch && p == 1)
+                v *= rising ? 1.4 : 0.6;
+            hostTouch[pins[p]] = (uint32_t)std::max(0.0, v);
+        }
+        kbd.Loop();
+        if (kbd.Available())
+        {
+            if (kbd.KeyCode() == 2)
+                presses++;
+            else
+                falsePresses++;
+            kbd.Handled();
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / scans;
+    printf("     presses %d/%d, false %d, %.1f ns/scan (incl. simulation)\n", presses, scans / 200000, falsePresses, ns);
+    check(presses == scans / 200000, "every touch detected");
+    check(falsePresses == 0, "no false presses");
+}
+
+// 1000 s, pad 3 steps 14% towards a touch at 100 s and again at 500 s (28% > press threshold in total),
+// e.g. a cable moved or a cover put on, a 400 ms touch on pad 2 and pad 3 every 200 s
+static void stepDrift(bool rising)
+{
+    std::mt19937 rng(2);
+    std::normal_distribution<double> noise(0, 6.0);
+    uint8_t pins[4] = {4, 12, 13, 14};
+    for (uint8_t pin : pins)
+        hostTouch[pin] = 800;
+
+    MTkbd kbd;
+    kbd.BeginTouch(4, pins);
+    const int scans = 1000000;
+    int presses = 0, falsePresses = 0;
+    for (int i = 0; i < scans; i++)
+    {
+        hostMicros = (int64_t)i * 1000;
+        double step = 1 + ((i > 100000) + (i > 500000)) * (rising ? 0.14 : -0.14);
+        int phase = i % 200000;
+        for (uint8_t p = 0; p < 4; p++)
+        {
+            double v = 800 * (p == 2 ? step : 1.0) + noise(rng);
+            if ((p == 1 && phase > 150000 && phase < 150400) || (p == 2 && phase > 170000 && phase < 170400))
+                v *= rising ? 1.4 : 0.6;
+            hostTouch[pins[p]] = (uint32_t)std::max(0.0, v);
+        }
+        kbd.Loop();
+        if (kbd.Available())
+        {
+            if ((kbd.KeyCode() == 2 && phase > 150000 && phase < 151000) ||
+                (kbd.KeyCode() == 4 && phase > 170000 && phase < 171000))
+                presses++;
+            else
+                falsePresses++;
+            kbd.Handled();
+        }
+    }
+    printf("     step %s: presses %d/%d, false %d\n", rising ? "rising" : "falling", presses, 2 * scans / 200000,
+           falsePresses);
+    check(presses == 2 * scans / 200000 && falsePresses == 0, "touches detected after drift steps, no stuck pad");
+}
+
+// a step beyond the press threshold reads as a held pad until BeginTouch() learns the baselines again
+static void stepBeyondPress(bool rising)
+{
+    uint8_t pins[2] = {4, 12};
+    hostTouch[4] = hostTouch[12] = 800;
+    MTkbd kbd;
+    kbd.BeginTouch(2, pins);
+    hostTouch[4] = rising ? 1040 : 560; // 30% step
+    bool held = true;
+    for (int i = 0; i < 20000; i++)
+    {
+        hostMicros = i * 1000LL;
+        kbd.Loop();
+        held = held && (i < 100 || kbd.KeyCode() == 1);
+    }
+    kbd.BeginTouch(2, pins);
+    bool released = true;
+    for (int i = 20000; i < 21000; i++)
+    {
+        hostMicros = i * 1000LL;
+        kbd.Loop();
+        released = released && !kbd.Available() && kbd.KeyCode() == 0;
+    }
+    check(held && released, "step beyond press threshold held until BeginTouch()");
+}
+
+// cost of one scan without the simulation around it
+static void scanCost()
+{
+    uint8_t pins[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    const int scans = 5000000;
+    for (int touch = 0; touch < 2; touch++)
+    {
+        for (uint8_t pin : pins)
+        {
+            hostTouch[pin] = 800;
+            hostPin[pin] = HIGH;
+        }
+        MTkbd kbd;
+        if (touch)
+            kbd.BeginTouch(8, pins);
+        else
+            kbd.Begin(true, 8, pins);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < scans; i++)
+        {
+            hostMicros = i * 1000LL;
+            hostTouch[1 + (i & 7)] = 790 + (i & 15);
+            kbd.Loop();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / scans;
+        printf("     %s %.1f ns/scan\n", touch ? "touch  " : "digital", ns);
+    }
+}
+
+// Begin() after BeginTouch() must drop touch mode, also after a failed BeginTouch()
+static void beginResetsTouch(bool failFirst)
+{
+    uint8_t pins[2] = {20, 21};
+    uint8_t duplicate[2] = {20, 20};
+    hostTouch[20] = hostTouch[21] = 800;
+    hostPin[20] = hostPin[21] = HIGH;
+    MTkbd kbd;
+    bool failed = !kbd.BeginTouch(2, failFirst ? duplicate : pins);
+    kbd.Begin(true, 2, pins);
+    hostTouch[20] = 100; // would be a touch, must be ignored
+    hostPin[21] = LOW;   // digital press on key 2
+    for (int i = 0; i < 1000 && !kbd.Available(); i++)
+    {
+        hostMicros = i * 1000LL;
+        if (i == 200)
+            hostPin[21] = HIGH;
+        kbd.Loop();
+    }
+    check(failed == failFirst && kbd.Available() && kbd.KeyCode() == 2,
+          failFirst ? "Begin() after a failed BeginTouch() scans again" : "Begin() after BeginTouch() reads digital pins");
+}
+
+int main()
+{
+    hostQuiet = true;
+    driftAndNoise(MTKBD_TOUCH_RISING);
+    stepDrift(MTKBD_TOUCH_RISING);
+    stepBeyondPress(MTKBD_TOUCH_RISING);
+    scanCost();
+    beginResetsTouch(false);
+    beginResetsTouch(true);
+    return HostTestResult();
+}
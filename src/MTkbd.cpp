@@ -28,17 +28,29 @@
 
 #include "MTkbd.h"
 
+const char *const MTkbd::pattern_s[PATTERN_MAX] = {"NONE", "START", "RUN", "END", "READY"};
+const uint8_t MTkbd::defaultKeys[4] = {0, 2, 4, 36};
+
+// RAM per keyboard stays small for setups with many keyboards, ESP32: 96 bytes + pattern buffer,
+// the snapshot (MTKBD_SNAPSHOT, default on) adds 44 bytes
+static_assert(sizeof(MTkbd) <= (sizeof(void *) == 4 ? 96 : 112) +
+                                   (MTKBD_SNAPSHOT ? (sizeof(void *) == 4 ? 44 : 40) + MTKBD_SNAPSHOT_PATTERN - 16 : 0),
+              "MTkbd instance grew, check member layout");
+
 MTkbd::MTkbd()
+    : _keyDown(false), _keyCodeValid(false), _keyCodeReady(false), _snapDirty(true),
+      _initError(false), _activeLow(true), _waitHandled(false), _showLongPressInfo(true), _showPatternInfo(true),
+      _touchMode(false)
 {
-    _patternMode = PATTERN_NONE;
+    _pattern = new char[_maxPatternLength + 1];
     clearPattern();
-    _keyCode = 0;
-    _lastKeyCode = 0;
     clearData();
 }
 MTkbd::~MTkbd()
 {
-    delete _keys;
+    delete[] _pattern;
+    delete[] _touchBaseline;
+    delete[] _reportBuf;
 };
 
 /// @brief setup keyboard with key pins
@@ -48,18 +60,20 @@ MTkbd::~MTkbd()
 /// @return true if settings are correct
 bool MTkbd::Begin(const bool activeLow, const uint8_t numKeys, const uint8_t keys[])
 {
-    _patternMode = PATTERN_NONE;
+    resetEvent();
     _activeLow = activeLow;
+    _touchMode = false;
+    delete[] _touchBaseline;
+    _touchBaseline = nullptr;
     if (numKeys < 1 || numKeys > 8)
     {
-        if (outputEnabled)
+        if (textOutput())
             OUTPORT.println(F("MTkbd ERROR: key array allow only 1..8 keys!"));
         _initError = true;
         return false;
     }
 
     _numKeys = numKeys;
-    _keys = new uint8_t[_numKeys];
     for (uint8_t idx = 0; idx < _numKeys; idx++)
     {
         if (idx > 0)
@@ -68,7 +82,7 @@ bool MTkbd::Begin(const bool activeLow, const uint8_t numKeys, const uint8_t key
             {
                 if (_keys[tst] == keys[idx])
                 {
-                    if (outputEnabled)
+                    if (textOutput())
                     {
                         OUTPORT.print(F("MTkbd ERROR: duplicate use of key io pin detected! Key IO pin "));
                         OUTPORT.println(keys[idx]);
@@ -86,20 +100,98 @@ bool MTkbd::Begin(const bool activeLow, const uint8_t numKeys, const uint8_t key
             pinMode(_keys[idx], INPUT_PULLDOWN);
     }
     _patternKeyCode = 0;
-    clearPattern();
-    _keyCode = 0;
-    _lastKeyCode = 0;
-    clearData();
+    _initError = false;
+    return true;
+}
+
+/// @brief setup keyboard with capacitive touch pads
+/// @param numKeys number of touch pads to handle with keyboard (1..8)
+/// @param pins array of the touch pad io pins lsb to msb, pads must be untouched during begin,
+///        call again to learn the baselines after a step beyond the press threshold (pad reads as held)
+/// @return true if settings are correct, false if the chip has no touch sensor
+bool MTkbd::BeginTouch(const uint8_t numKeys, const uint8_t pins[])
+{
+    resetEvent();
+#if MTKBD_TOUCH
+    _touchMode = true;
+    if (numKeys < 1 || numKeys > 8)
+    {
+        if (textOutput())
+            OUTPORT.println(F("MTkbd ERROR: touch array allow only 1..8 pads!"));
+        _initError = true;
+        return false;
+    }
+
+    _numKeys = numKeys;
+    delete[] _touchBaseline;
+    _touchBaseline = new uint32_t[_numKeys];
+    for (uint8_t idx = 0; idx < _numKeys; idx++)
+    {
+        for (uint8_t tst = 0; tst < idx; tst++)
+        {
+            if (_keys[tst] == pins[idx])
+            {
+                if (textOutput())
+                {
+                    OUTPORT.print(F("MTkbd ERROR: duplicate use of touch io pin detected! Touch IO pin "));
+                    OUTPORT.println(pins[idx]);
+                }
+                _initError = true;
+                return false;
+            }
+        }
+        _keys[idx] = pins[idx];
+
+        uint32_t sum = 0; // start baseline with the average of some untouched reads
+        for (uint8_t smp = 0; smp < 16; smp++)
+            sum += touchRead(_keys[idx]);
+        _touchBaseline[idx] = (sum / 16) << 8;
+    }
+    _touchState = 0;
+    _patternKeyCode = 0;
+    _initError = false;
     return true;
+#else
+    _touchMode = false;
+    if (textOutput())
+        OUTPORT.println(F("MTkbd ERROR: this chip has no touch sensor!"));
+    _initError = true;
+    return false;
+#endif
 }
 
 uint8_t MTkbd::KeyCode() { return _keyCode; }
 uint8_t MTkbd::Repeat() { return _repeatNr == 0 ? 0 : _repeatNr + 1; }
 uint32_t MTkbd::Duration() { return _durationMS; }
 bool MTkbd::IsPattern() { return _patternMode != PATTERN_NONE; }
-String MTkbd::Pattern() { return String(_patternString); }
+String MTkbd::Pattern() { return String(_pattern); }
+
+#if MTKBD_SNAPSHOT
+/// @brief consistent copy of the event published by the last Loop(), safe to call from another core / task
+///        without a mutex, Loop() never waits for readers. Acknowledge it there with Handled(evt.seq).
+///        Only Loop() publishes, a reader retries while it does: never call this from a task that can
+///        preempt the Loop() task on the same core, it would spin forever.
+/// @return keycode, repeat, duration, available, pattern of the same loop
+MTkbd::event_t MTkbd::Snapshot()
+{
+    uint32_t words[SNAP_WORDS];
+    uint32_t seq0, seq1;
+    do
+    {
+        seq0 = _snapSeq.load(std::memory_order_acquire);
+        for (uint8_t idx = 0; idx < SNAP_WORDS; idx++)
+            words[idx] = _snapData[idx].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq1 = _snapSeq.load(std::memory_order_relaxed);
+    } while ((seq0 & 1) || seq0 != seq1); // writer was busy -> read again
+    event_t evt;
+    memcpy(&evt, words, sizeof(evt));
+    return evt;
+}
+#endif
 
 /// @brief set waitHandled, the handled function must be called to continue keyboard loop
+///        without it keys are scanned on, a new press drops a key event not handled yet, a pattern is kept
 /// @param waitHandled true if handled function must be called
 void MTkbd::SetWaitHandled(bool waitHandled) { _waitHandled = waitHandled; }
 
@@ -124,8 +216,15 @@ void MTkbd::SetShowPattern(bool showPattern) { _showPatternInfo = showPattern; }
 bool MTkbd::GetShowPattern() { return _showPatternInfo; }
 
 /// @brief set max length for pattern before automatic end pattern
-/// @param maxPatternLength number of characters pattern will be +1 char for '\0'
-void MTkbd::SetMaxPatternLength(uint8_t maxPatternLength) { _maxPatternLength = maxPatternLength; }
+/// @param maxPatternLength number of characters pattern will be +1 char for '\0', clears the actual pattern
+void MTkbd::SetMaxPatternLength(uint8_t maxPatternLength)
+{
+    _maxPatternLength = maxPatternLength;
+    delete[] _pattern;
+    _pattern = new char[_maxPatternLength + 1];
+    clearPattern();
+    _snapDirty = true;
+}
 
 /// @brief get max length for pattern before automatic end pattern
 /// @return number of characters pattern will be -1 char for '\0'
@@ -179,6 +278,54 @@ void MTkbd::SetPatternTimeout(uint32_t timeoutMS) { _patternTimeout = timeoutMS;
 /// @return timeout in ms
 uint32_t MTkbd::GetPatternTimeout() { return _patternTimeout; };
 
+/// @brief Set touch thresholds as % of the pad baseline, press must be above release (hysteresis)
+/// @param pressPct pad is pressed when its value moves more than this % away from baseline (max 99)
+/// @param releasePct pad is released when its value is back within this % of baseline
+void MTkbd::SetTouchThreshold(uint8_t pressPct, uint8_t releasePct)
+{
+    if (pressPct > 99)
+        pressPct = 99;
+    if (releasePct > pressPct)
+        releasePct = pressPct;
+    _touchPressQ8 = ((uint16_t)pressPct << 8) / 100;
+    _touchReleaseQ8 = ((uint16_t)releasePct << 8) / 100;
+}
+
+/// @brief Get touch press threshold
+/// @return % away from baseline
+uint8_t MTkbd::GetTouchPressPct() { return ((uint16_t)_touchPressQ8 * 100 + 128) >> 8; }
+
+/// @brief Get touch release threshold
+/// @return % away from baseline
+uint8_t MTkbd::GetTouchReleasePct() { return ((uint16_t)_touchReleaseQ8 * 100 + 128) >> 8; }
+
+/// @brief Set how fast the baseline of untouched pads follows drift, 64x slower between release and press
+/// @param shift baseline moves 1/2^shift of the difference each scan (1..15)
+void MTkbd::SetTouchFilter(uint8_t shift)
+{
+    if (shift < 1)
+        shift = 1;
+    if (shift > 15)
+        shift = 15;
+    _touchFilterShift = shift;
+}
+
+/// @brief Get how fast the baseline of untouched pads follows drift
+/// @return shift
+uint8_t MTkbd::GetTouchFilter() { return _touchFilterShift; }
+
+/// @brief Set output of OUTPORT to info lines or binary event records -> MTkbdReport.h
+/// @param mode REPORT_TEXT or REPORT_BINARY, binary records are sent only when outputEnabled
+void MTkbd::SetReportMode(report_e mode)
+{
+    if (mode < REPORT_MAX)
+        _reportMode = mode;
+}
+
+/// @brief Get output mode of OUTPORT
+/// @return REPORT_TEXT or REPORT_BINARY
+MTkbd::report_e MTkbd::GetReportMode() { return _reportMode; }
+
 /// @brief get the keycode for a key pin number
 /// @param pin io pin of the key
 /// @return keycode of this key when pressed
@@ -205,12 +352,14 @@ void MTkbd::StartPasswordMode(uint8_t timeoutSec)
 {
     clearData();
     clearPattern();
-    _lastKeyCode = 0;
     _keyCode = 0;
     _keyCodeReady = false;
+    _state = S_PAT_START;
     _patternMode = PATTERN_START;
     _patternTimeout = timeoutSec * 1000;
-    Serial.println(">>> Start Password Mode");
+    if (textOutput())
+        OUTPORT.println(F(">>> Start Password Mode"));
+    _snapDirty = true;
 }
 
 /// @brief Loop keyboard should run in loop()
@@ -218,18 +367,15 @@ void MTkbd::Loop()
 {
     if (_initError)
         return;
-    if (!_waitHandled || (_waitHandled & !_keyCodeReady))
+#if MTKBD_SNAPSHOT
+    // a request stays stored, it can match only once as every new event gets a new serial
+    if (_keyCodeReady && _handledReq.load(std::memory_order_acquire) == _eventSeq)
+        Handled();
+#endif
+    if (!_waitHandled || !_keyCodeReady)
     {
         _rawReadMS = (uint32_t)(esp_timer_get_time() / 1000);
-        _rawKeyCode = 0;
-        _keyCodeValid = false;
-        for (uint8_t idx = 0; idx < _numKeys; idx++)
-        {
-            bool _state = digitalRead(_keys[idx]) == HIGH;
-            _rawKeyCode = _rawKeyCode | (_state << idx);
-        }
-        if (_activeLow)
-            _rawKeyCode = ~_rawKeyCode & 0b11111111 >> (8 - _numKeys);
+        _rawKeyCode = _touchMode ? readTouch() : readKeys();
 
         if (_lastRawKeyCode != _rawKeyCode) // new rawKeyCode pressed
         {
@@ -239,202 +385,362 @@ void MTkbd::Loop()
 
         _keyCodeValid = ((_rawReadMS - _stableMS) > _bounceMS); // keyCode is valid after bounce time
 
-        if (_patternMode == PATTERN_START)
-        {
-            _patternMode = PATTERN_RUN;
-            _keyCode = 0;
-            _lastKeyCode = 0;
-            clearData();
-            clearPattern();
-            _patternModeMS = _rawReadMS;
-            if (_showPatternInfo && outputEnabled)
-                OUTPORT.println(F("KBD PatternMode ready to enter"));
-        }
-        else if (_patternMode == PATTERN_RUN)
+        const transition_t &trans = _transitions[_state][nextInput()];
+        _state = trans.next;
+        doAction(trans.action);
+
+        if (_reportLen > 0)
+            flushReport();
+    }
+#if MTKBD_SNAPSHOT
+    publish();
+#endif
+}
+
+/// @brief key is ready for handling
+/// @return true = ready
+bool MTkbd::Available()
+{
+    return _keyCodeReady;
+}
+
+/// @brief after handled call this to reset keyboard for next keys
+void MTkbd::Handled()
+{
+    resetEvent();
+}
+
+#if MTKBD_SNAPSHOT
+/// @brief handled from another core / task, lock free, done at the start of the next Loop()
+/// @param seq serial of the handled event from Snapshot(), ignored if a newer event is ready
+void MTkbd::Handled(uint32_t seq) { _handledReq.store(seq, std::memory_order_release); }
+#endif
+
+/////////////////////////////////////
+///  private functions start here ///
+/////////////////////////////////////
+
+/// @brief private state machine of Loop(): next state and action for each state and input
+///        columns IN_TICK, IN_DOWN, IN_AGAIN, IN_UP, IN_UP_FULL, IN_UP_PATTERN, IN_CLICK, IN_TIMEOUT
+const MTkbd::transition_t MTkbd::_transitions[S_MAX][IN_MAX] = {
+    // S_IDLE
+    {{S_IDLE, ACT_NONE}, {S_DOWN, ACT_PRESS}, {S_DOWN, ACT_PRESS}, {S_IDLE, ACT_NONE}, {S_IDLE, ACT_NONE}, {S_IDLE, ACT_NONE}, {S_IDLE, ACT_NONE}, {S_IDLE, ACT_NONE}},
+    // S_DOWN
+    {{S_DOWN, ACT_HOLD}, {S_DOWN, ACT_PRESS}, {S_DOWN, ACT_PRESS}, {S_UP, ACT_RELEASE}, {S_UP, ACT_RELEASE}, {S_PAT_START, ACT_PATTERN_START}, {S_DOWN, ACT_HOLD}, {S_DOWN, ACT_HOLD}},
+    // S_UP
+    {{S_UP, ACT_NONE}, {S_DOWN, ACT_PRESS}, {S_DOWN, ACT_AGAIN}, {S_UP, ACT_NONE}, {S_UP, ACT_NONE}, {S_UP, ACT_NONE}, {S_READY, ACT_READY}, {S_UP, ACT_NONE}},
+    // S_READY, scanned only without SetWaitHandled(true): a new press drops the waiting event
+    {{S_READY, ACT_NONE}, {S_DOWN, ACT_REPLACE}, {S_DOWN, ACT_REPLACE}, {S_READY, ACT_NONE}, {S_READY, ACT_NONE}, {S_READY, ACT_NONE}, {S_READY, ACT_NONE}, {S_READY, ACT_NONE}},
+    // S_PAT_START
+    {{S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}, {S_PAT_IDLE, ACT_PATTERN_RUN}},
+    // S_PAT_IDLE
+    {{S_PAT_IDLE, ACT_NONE}, {S_PAT_DOWN, ACT_PRESS}, {S_PAT_DOWN, ACT_PRESS}, {S_PAT_IDLE, ACT_NONE}, {S_PAT_IDLE, ACT_NONE}, {S_PAT_IDLE, ACT_NONE}, {S_PAT_IDLE, ACT_NONE}, {S_PAT_READY, ACT_PATTERN_TIMEOUT}},
+    // S_PAT_DOWN
+    {{S_PAT_DOWN, ACT_HOLD}, {S_PAT_DOWN, ACT_PRESS}, {S_PAT_DOWN, ACT_PRESS}, {S_PAT_IDLE, ACT_PATTERN_ADD}, {S_PAT_READY, ACT_PATTERN_FULL}, {S_PAT_READY, ACT_PATTERN_END}, {S_PAT_DOWN, ACT_HOLD}, {S_PAT_READY, ACT_PATTERN_TIMEOUT}},
+    // S_PAT_READY
+    {{S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}, {S_PAT_READY, ACT_NONE}},
+};
+
+/// @brief private classify this scan as one input of the state machine, same work for every state
+/// @return input
+MTkbd::input_e MTkbd::nextInput()
+{
+    input_e in = IN_TICK;
+    if (_keyCodeValid && _rawKeyCode != _stableKeyCode) // stable keycode changed
+    {
+        if (_rawKeyCode == 0)
         {
-            if ((_rawReadMS - _patternModeMS) > _patternTimeout)
-            {
-                if (outputEnabled)
-                    OUTPORT.println(F("KBD PatternMode pattern timeout"));
-                patternReady();
-            }
+            bool patternKey = _patternKeyCode > 0 &&
+                              _keyCode == _patternKeyCode &&
+                              _durationMS > _patternMinMS &&
+                              _durationMS < _patternMaxMS;
+            bool full = _patternPos + (_numKeys <= 4 ? 1 : 2) > _maxPatternLength;
+            in = patternKey ? IN_UP_PATTERN : full ? IN_UP_FULL : IN_UP;
         }
+        else
+            in = (_stableKeyCode == 0 && _rawKeyCode == _keyCode) ? IN_AGAIN : IN_DOWN;
+        _stableKeyCode = _rawKeyCode;
+        _keyDown = _rawKeyCode > 0;
+    }
+    else if (!_keyDown && (_rawReadMS - _stableMS) > _doubleClickMS) // released for longer than double click
+        in = IN_CLICK;
 
-        if (_keyCodeValid)
-        {
-            _keyDown = _rawKeyCode > 0;
-            if (_rawKeyCode > 0)
-                _keyCode = _rawKeyCode;
+    if (_patternMode == PATTERN_RUN && (_rawReadMS - _patternModeMS) > _patternTimeout)
+        in = IN_TIMEOUT;
+    return in;
+}
 
-            if (_lastKeyCode != _keyCode) // keycode changed -> print out keycode
-            {
-                clearData();
-                _keyCode = _rawKeyCode;
-                _lastKeyCode = _keyCode;
-            }
+/// @brief private run the action of a transition
+/// @param action action
+void MTkbd::doAction(action_e action)
+{
+    if (action != ACT_NONE) // every action changes event fields
+        _snapDirty = true;
+    switch (action)
+    {
+    case ACT_NONE:
+        break;
+    case ACT_REPLACE: // key event not handled, the new press replaces it
+        _keyCodeReady = false;
+        // fall through
+    case ACT_PRESS: // new keycode pressed -> new event
+        clearData();
+        _keyCode = _stableKeyCode;
+        _firstPressMS = _rawReadMS;
+        hold();
+        break;
+    case ACT_AGAIN: // same keycode pressed again within double click
+        _repeatNr++;
+        hold();
+        break;
+    case ACT_HOLD:
+        hold();
+        break;
+    case ACT_RELEASE: // duration is first press to release from now on
+        _durationMS = _rawReadMS - _firstPressMS;
+        break;
+    case ACT_READY:
+        report(MTkbdReport::EVT_KEY);
+        setReady();
+        break;
+    case ACT_PATTERN_START:
+        if (_showPatternInfo && textOutput())
+            OUTPORT.println(F("KBD PatternMode started"));
+        _patternMode = PATTERN_START;
+        clearData();
+        clearPattern();
+        break;
+    case ACT_PATTERN_RUN:
+        _patternMode = PATTERN_RUN;
+        _keyCode = 0;
+        clearData();
+        clearPattern();
+        _patternModeMS = _rawReadMS;
+        if (_showPatternInfo && textOutput())
+            OUTPORT.println(F("KBD PatternMode ready to enter"));
+        break;
+    case ACT_PATTERN_ADD:
+        patternAdd();
+        break;
+    case ACT_PATTERN_FULL:
+        if (textOutput())
+            OUTPORT.println(F("KBD PatternMode pattern full"));
+        patternReady();
+        break;
+    case ACT_PATTERN_END:
+        if (_showPatternInfo && textOutput())
+            OUTPORT.println(F("KBD PatternMode ended"));
+        patternReady();
+        break;
+    case ACT_PATTERN_TIMEOUT:
+        if (textOutput())
+            OUTPORT.println(F("KBD PatternMode pattern timeout"));
+        patternReady();
+        break;
+    default:
+        break;
+    }
+}
 
-            if (!_keyDown) // all keys released
-            {
-                if (_releaseMS == 0)
-                    _releaseMS = _rawReadMS;
+/// @brief private key is held, update duration and show long press info
+void MTkbd::hold()
+{
+    if (!_keyCodeValid) // keys bounce -> keep duration of last stable scan
+        return;
+    _durationMS = _rawReadMS - _firstPressMS;
 
-                if (_patternKeyCode > 0 &&
-                    _keyCode == _patternKeyCode &&
-                    _durationMS > _patternMinMS &&
-                    _durationMS < _patternMaxMS)
-                {
-                    _patternModeMS = _rawReadMS;
-                    if (_patternMode == PATTERN_NONE)
-                    {
-                        _patternMode = PATTERN_START;
-                        if (_showPatternInfo && outputEnabled)
-                            OUTPORT.println(F("KBD PatternMode started"));
-                        clearData();
-                        clearPattern();
-                    }
-                    else if (_patternMode == PATTERN_RUN)
-                    {
-                        if (_showPatternInfo && outputEnabled)
-                            OUTPORT.println(F("KBD PatternMode ended"));
-                        patternReady();
-                    }
-                }
-                else
-                {
-                    if (_patternMode == PATTERN_NONE)
-                    {
-                        if (_firstPressMS > 0 && ((_stableMS + _doubleClickMS) < _rawReadMS)) // keycode valid for handle >> keyready
-                        {
-                            _keyCodeReady = true;
-                            _durationMS = _releaseMS - _firstPressMS;
-                        }
-                    }
-                    else if (_patternMode == PATTERN_RUN)
-                    {
-                        if (_keyCode > 0)
-                        {
-                            _patternModeMS = _rawReadMS;
-                            if (_numKeys <= 4)
-                            {
-                                if (_patternPos < (_maxPatternLength))
-                                {
-                                    char _ch = hex_digit(_keyCode);
-                                    _pattern[_patternPos] = _ch;
-                                    _patternPos++;
-                                    _pattern[_patternPos] = '\0';
-                                    if (_showPatternInfo && outputEnabled)
-                                        OUTPORT.println("KBD PatternMode add key '" + String(_ch) + "' -> act pattern is '" + String(_pattern) + "'");
-                                }
-                                else
-                                {
-                                    if (outputEnabled)
-                                        OUTPORT.println(F("KBD PatternMode pattern full"));
-                                    patternReady();
-                                }
-                            }
-                            else
-                            {
-                                if (_patternPos < (_maxPatternLength - 1))
-                                {
-                                    char _ch0 = byte_to_hex(_keyCode)[0];
-                                    char _ch1 = byte_to_hex(_keyCode)[1];
-                                    _pattern[_patternPos] = _ch0;
-                                    _pattern[_patternPos + 1] = _ch1;
-                                    _patternPos += 2;
-                                    _pattern[_patternPos] = '\0';
-                                    if (_showPatternInfo & outputEnabled)
-                                        OUTPORT.println("KBD PatternMode add key '" + String(_ch0) + String(_ch1) + "' -> act pattern is '" + String(_pattern) + "'");
-                                }
-                                else
-                                {
-                                    if (outputEnabled)
-                                        OUTPORT.println(F("KBD PatternMode pattern full"));
-                                    patternReady();
-                                }
-                            }
-                            _patternString = String(_pattern).c_str();
-                            _keyCode = 0;
-                            _lastKeyCode = 0;
-                        }
-                        if ((_rawReadMS - _lastPressMS) > _patternTimeout)
-                        {
-                            if (outputEnabled)
-                                OUTPORT.println(F("KBD PatternMode pattern timeout"));
-                            patternReady();
-                        }
-                    }
-                }
-            }
-            else // some keys are pressed
-            {
-                if (_firstPressMS == 0)
-                    _firstPressMS = _rawReadMS;
-                else
-                    _lastPressMS = _rawReadMS;
+    if (_repeatNr == 0 &&
+        _durationMS > _infoResponse &&
+        _lastInfoMS + _infoResponse < _rawReadMS)
+    {
+        _lastInfoMS = _rawReadMS;
+        if (_showLongPressInfo && textOutput())
+            OUTPORT.printf("KBD long pressed KeyCode %i duration %i ms\r\n", _keyCode, _durationMS);
+        else if (_showLongPressInfo)
+            report(MTkbdReport::EVT_LONGPRESS);
+    }
+}
 
-                if (_patternMode == PATTERN_NONE)
-                {
-                    if (_keyCode == _lastKeyCode) // keycode is lastkeycode
-                    {
-                        if (_releaseMS > 0)
-                        {
-                            _repeatNr++;
-                            _releaseMS = 0;
-                        }
-                    }
-                    else
-                    {
-                        _releaseMS = 0;
-                        _lastKeyCode = 0;
-                    }
-                }
+/// @brief private add released keycode to pattern as hex char(s)
+void MTkbd::patternAdd()
+{
+    _patternModeMS = _rawReadMS;
+    if (_numKeys <= 4)
+    {
+        char _ch = hex_digit(_keyCode);
+        _pattern[_patternPos] = _ch;
+        _patternPos++;
+        _pattern[_patternPos] = '\0';
+        if (_showPatternInfo && textOutput())
+            OUTPORT.println("KBD PatternMode add key '" + String(_ch) + "' -> act pattern is '" + String(_pattern) + "'");
+    }
+    else
+    {
+        std::array<char, 2> _ch = byte_to_hex(_keyCode);
+        _pattern[_patternPos] = _ch[0];
+        _pattern[_patternPos + 1] = _ch[1];
+        _patternPos += 2;
+        _pattern[_patternPos] = '\0';
+        if (_showPatternInfo && textOutput())
+            OUTPORT.println("KBD PatternMode add key '" + String(_ch[0]) + String(_ch[1]) + "' -> act pattern is '" + String(_pattern) + "'");
+    }
+    _keyCode = 0;
+}
+
+/// @brief private read digital key pins
+/// @return raw keycode
+uint8_t MTkbd::readKeys()
+{
+    uint8_t code = 0;
+    for (uint8_t idx = 0; idx < _numKeys; idx++)
+    {
+        bool _state = digitalRead(_keys[idx]) == HIGH;
+        code = code | (_state << idx);
+    }
+    if (_activeLow)
+        code = ~code & 0b11111111 >> (8 - _numKeys);
+    return code;
+}
 
-                _durationMS = _rawReadMS - _firstPressMS;
+/// @brief private read touch pads, track untouched baselines and apply press/release hysteresis
+/// @return raw keycode
+uint8_t MTkbd::readTouch()
+{
+#if MTKBD_TOUCH
+    uint32_t raw[8];
+    for (uint8_t idx = 0; idx < _numKeys; idx++) // sample all pads in one batch
+        raw[idx] = touchRead(_keys[idx]);
 
-                if (_repeatNr == 0 &&
-                    _durationMS > _infoResponse &&
-                    _lastInfoMS + _infoResponse < _rawReadMS &&
-                    (_patternMode == PATTERN_NONE || _patternMode == PATTERN_RUN))
-                {
-                    _lastInfoMS = _rawReadMS;
-                    if (_showLongPressInfo && outputEnabled)
-                        OUTPORT.printf("KBD long pressed KeyCode %i duration %i ms\r\n", _keyCode, _rawReadMS - _firstPressMS);
-                }
-            }
+    for (uint8_t idx = 0; idx < _numKeys; idx++)
+    {
+        int32_t base = (int32_t)_touchBaseline[idx];
+        int32_t value = (int32_t)(raw[idx] << 8);
+#if MTKBD_TOUCH_RISING
+        int32_t delta = value - base;
+#else
+        int32_t delta = base - value;
+#endif
+        int32_t releaseQ8 = (int32_t)((base >> 8) * _touchReleaseQ8); // thresholds in Q24.8 like delta
+        uint8_t bit = 1 << idx;
+        if (_touchState & bit)
+        {
+            if (delta < releaseQ8)
+                _touchState &= ~bit;
+        }
+        else if (delta > (int32_t)((base >> 8) * _touchPressQ8))
+            _touchState |= bit;
+        else
+        {
+            // untouched -> baseline follows drift, 64x slower between release and press: a short finger
+            // approach barely moves it, a drift step is learned before the next one adds up to a stuck pad
+            uint8_t shift = delta < releaseQ8 ? _touchFilterShift : _touchFilterShift + 6;
+            _touchBaseline[idx] = (uint32_t)(base + ((value - base) >> shift));
         }
     }
+    return _touchState;
+#else
+    return 0;
+#endif
 }
 
-/// @brief key is ready for handling
-/// @return true = ready
-bool MTkbd::Available()
+/// @brief private info lines are printed on OUTPORT
+/// @return true if enabled and not in binary report mode
+bool MTkbd::textOutput() { return outputEnabled && _reportMode == REPORT_TEXT; }
+
+/// @brief private add a binary event record to the report buffer, flushed at end of loop
+/// @param type record type
+void MTkbd::report(MTkbdReport::type_e type)
 {
-    return _keyCodeReady;
+    if (!outputEnabled || _reportMode != REPORT_BINARY)
+        return;
+    bool pattern = type == MTkbdReport::EVT_PATTERN;
+    uint8_t patternLength = pattern ? _patternPos : 0;
+    uint16_t need = MTKBD_REPORT_OVERHEAD + MTKBD_REPORT_HEADER + patternLength;
+    if (_reportLen + need > _reportSize)
+        flushReport();
+    if (need > _reportSize) // room for two records, a key event and a long press info fit in one loop
+    {
+        delete[] _reportBuf;
+        _reportSize = need * 2;
+        _reportBuf = new uint8_t[_reportSize];
+    }
+    _reportLen += MTkbdReport::Encode(_reportBuf + _reportLen, _reportSize - _reportLen, _reportSeq++, type,
+                                      pattern ? 0 : _keyCode, pattern ? 0 : Repeat(), pattern ? 0 : _durationMS,
+                                      _rawReadMS, _pattern, patternLength);
 }
 
-/// @brief after handled call this to reset keyboard for next keys
-void MTkbd::Handled()
+/// @brief private write all buffered binary records with one write
+void MTkbd::flushReport()
+{
+    if (_reportLen > 0)
+        OUTPORT.write(_reportBuf, _reportLen);
+    _reportLen = 0;
+}
+
+#if MTKBD_SNAPSHOT
+/// @brief private publish event for Snapshot() readers (seqlock), called only at the end of Loop(), the single writer
+void MTkbd::publish()
+{
+    if (!_snapDirty)
+        return;
+    _snapDirty = false;
+    event_t evt;
+    memset(&evt, 0, sizeof(evt)); // padding too, the words are compared below
+    evt.seq = _eventSeq;
+    evt.durationMS = _durationMS;
+    evt.keyCode = _keyCode;
+    evt.repeat = Repeat();
+    evt.available = _keyCodeReady;
+    evt.isPattern = IsPattern();
+    evt.patternLength = _patternPos;
+    strncpy(evt.pattern, _pattern, MTKBD_SNAPSHOT_PATTERN);
+    uint32_t words[SNAP_WORDS] = {};
+    memcpy(words, &evt, sizeof(evt));
+
+    bool changed = false; // only the writer stores _snapData, so reading it back needs no lock
+    for (uint8_t idx = 0; idx < SNAP_WORDS && !changed; idx++)
+        changed = _snapData[idx].load(std::memory_order_relaxed) != words[idx];
+    if (!changed)
+        return;
+
+    uint32_t seq = _snapSeq.load(std::memory_order_relaxed);
+    _snapSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint8_t idx = 0; idx < SNAP_WORDS; idx++)
+        _snapData[idx].store(words[idx], std::memory_order_relaxed);
+    _snapSeq.store(seq + 2, std::memory_order_release);
+}
+#endif
+
+/// @brief private back to S_IDLE without event or pattern, keys still held start a new press
+void MTkbd::resetEvent()
 {
     _keyCodeReady = false;
+    _state = S_IDLE;
     _patternMode = PATTERN_NONE;
-    _patternModeMS = 0;
-    _patternPos = 0;
     _keyCode = 0;
-    _lastKeyCode = 0;
+    _stableKeyCode = 0;
+    _keyDown = false;
     clearPattern();
     clearData();
+    _snapDirty = true;
 }
 
-/////////////////////////////////////
-///  private functions start here ///
-/////////////////////////////////////
+/// @brief private key event or pattern ready to handle, gets the next serial
+void MTkbd::setReady()
+{
+    _keyCodeReady = true;
+#if MTKBD_SNAPSHOT
+    if (++_eventSeq == 0) // 0 is the initial Handled(seq) request, never an event
+        _eventSeq = 1;
+#endif
+}
 
 /// @brief private for clear pattern
 void MTkbd::clearPattern()
 {
-    _pattern = new char[_maxPatternLength + 1];
-    for (uint8_t i = 0; i <= _maxPatternLength; i++)
-        _pattern[i] = '\0';
+    memset(_pattern, 0, _maxPatternLength + 1);
+    _patternPos = 0;
     _patternModeMS = 0;
 }
 
@@ -442,11 +748,8 @@ void MTkbd::clearPattern()
 void MTkbd::clearData()
 {
     _firstPressMS = 0;
-    _lastPressMS = 0;
     _durationMS = 0;
-    _releaseMS = 0;
     _repeatNr = 0;
-    _stableMS = 0;
 }
 
 /// @brief convert signle digit in a hex char
@@ -469,20 +772,19 @@ void MTkbd::patternReady()
 {
     _patternMode = PATTERN_READY;
     _patternModeMS = 0;
-    _patternString = String(_pattern);
-    _keyCodeReady = true;
+    report(MTkbdReport::EVT_PATTERN);
+    setReady();
     _keyCode = 0;
-    _lastKeyCode = 0;
     clearData();
 }
 
 void MTkbd::debug(uint8_t id, uint32_t dly)
 {
-    // Serial.printf("id:%3i rkc:%i lrkc:%i kc:%i lkc:%i rpt:%i dur:%i dwn:%s vld:%s rdy:%s  ms raw:%i stb:%i fpr:%i lpr:%i rel:%i pat:%i inf:%i  pat mode:%s  pos:%i  pattern:'%s'\r\n",
-    //               id, _rawKeyCode, _lastRawKeyCode, _keyCode, _lastKeyCode, _repeatNr, _durationMS,
+    // Serial.printf("id:%3i st:%i rkc:%i lrkc:%i skc:%i kc:%i rpt:%i dur:%i dwn:%s vld:%s rdy:%s  ms raw:%i stb:%i fpr:%i pat:%i inf:%i  pat mode:%s  pos:%i  pattern:'%s'\r\n",
+    //               id, _state, _rawKeyCode, _lastRawKeyCode, _stableKeyCode, _keyCode, _repeatNr, _durationMS,
     //               _keyDown ? "DNW" : "UP ", _keyCodeValid ? "VLD" : "---", _keyCodeReady ? "RDY" : "---",
-    //               _rawReadMS, _stableMS, _firstPressMS, _lastPressMS, _releaseMS, _patternModeMS, _lastInfoMS,
-    //               pattern_s[_patternMode].c_str(), _patternPos, String(_pattern).c_str());
+    //               _rawReadMS, _stableMS, _firstPressMS, _patternModeMS, _lastInfoMS,
+    //               pattern_s[_patternMode], _patternPos, _pattern);
     // Serial.printf("--- %i -------------------------------\r\n", esp_timer_get_time() / 1000);
     // delay(dly);
 }
\ No newline at end of file
@@ -30,11 +30,39 @@
 #define MTKBD_H
 
 #include <Arduino.h>
+#include <atomic>
+#include "MTkbdReport.h"
 
 #ifndef OUTPORT
 #define OUTPORT Serial
 #endif
 
+// touch pads exist on ESP32, ESP32-S2/S3, not on ESP32-C3/C6/H2
+#ifndef MTKBD_TOUCH
+#if defined(SOC_TOUCH_SENSOR_SUPPORTED) || (defined(SOC_TOUCH_SENSOR_NUM) && SOC_TOUCH_SENSOR_NUM > 0)
+#define MTKBD_TOUCH 1
+#else
+#define MTKBD_TOUCH 0
+#endif
+#endif
+
+// touch pads read lower when touched on ESP32, higher on ESP32-S2/S3 (touch sensor v2)
+#ifndef MTKBD_TOUCH_RISING
+#if defined(SOC_TOUCH_VERSION_2) || (defined(SOC_TOUCH_SENSOR_VERSION) && SOC_TOUCH_SENSOR_VERSION == 2)
+#define MTKBD_TOUCH_RISING 1
+#else
+#define MTKBD_TOUCH_RISING 0
+#endif
+#endif
+
+#ifndef MTKBD_SNAPSHOT
+#define MTKBD_SNAPSHOT 1 // 0: no Snapshot() / Handled(seq), saves 44 bytes per instance on ESP32
+#endif
+
+#ifndef MTKBD_SNAPSHOT_PATTERN
+#define MTKBD_SNAPSHOT_PATTERN 16 // max pattern chars copied into a Snapshot()
+#endif
+
 class MTkbd
 {
 public:
@@ -48,19 +76,43 @@ public:
         PATTERN_MAX
     };
 
-    const String pattern_s[PATTERN_MAX] = {F("NONE"), F("START"), F("RUN"), F("END"), F("READY")};
+    enum report_e : uint8_t
+    {
+        REPORT_TEXT,   // human readable info lines
+        REPORT_BINARY, // framed MTkbdReport records, no info lines
+        REPORT_MAX
+    };
+
+    struct event_t
+    {
+        uint32_t seq;                              // serial of the last event ready to handle -> Handled(seq)
+        uint32_t durationMS;                       // Duration()
+        uint8_t keyCode;                           // KeyCode()
+        uint8_t repeat;                            // Repeat()
+        bool available;                            // Available()
+        bool isPattern;                            // IsPattern()
+        uint8_t patternLength;                     // Pattern().length(), more than pattern holds if it was cut
+        char pattern[MTKBD_SNAPSHOT_PATTERN + 1];  // Pattern(), '\0' terminated
+    };
+
+    static const char *const pattern_s[PATTERN_MAX];
+    static const uint8_t defaultKeys[4];
 
     MTkbd();
     ~MTkbd();
     bool Begin(const bool activeLow = true,
                const uint8_t numKeys = 4,
-               const uint8_t keys[] = new uint8_t[4]{0, 2, 4, 36});
+               const uint8_t keys[] = defaultKeys);
+    bool BeginTouch(const uint8_t numKeys, const uint8_t pins[]);
 
     uint8_t KeyCode();
     uint8_t Repeat();
     uint32_t Duration();
     bool IsPattern();
     String Pattern();
+#if MTKBD_SNAPSHOT
+    event_t Snapshot();
+#endif
 
     void SetWaitHandled(bool waitHandled);
     bool GetWaitHandled();
@@ -81,6 +133,13 @@ public:
     uint32_t GetPatternMaxMS();
     void SetPatternTimeout(uint32_t timeoutMS = 30000);
     uint32_t GetPatternTimeout();
+    void SetTouchThreshold(uint8_t pressPct = 20, uint8_t releasePct = 10);
+    uint8_t GetTouchPressPct();
+    uint8_t GetTouchReleasePct();
+    void SetTouchFilter(uint8_t shift = 6);
+    uint8_t GetTouchFilter();
+    void SetReportMode(report_e mode);
+    report_e GetReportMode();
     uint8_t GetKeyCodeOfPin(uint8_t pin);
     void SetPatternKeyCode(uint8_t code);
     uint8_t GetPatternKeyCode();
@@ -89,10 +148,81 @@ public:
     void Loop();
     bool Available();
     void Handled();
+#if MTKBD_SNAPSHOT
+    void Handled(uint32_t seq);
+#endif
 
     bool outputEnabled = true; // enable OUTPORT prints -> default to Serial
 
 private:
+    friend struct MTkbdTest; // host tests in extras/host
+
+    enum state_e : uint8_t
+    {
+        S_IDLE,      // no key pressed
+        S_DOWN,      // keycode pressed
+        S_UP,        // keycode released, wait double click for repeat
+        S_READY,     // keycode ready, wait Handled()
+        S_PAT_START, // pattern mode starts with next loop
+        S_PAT_IDLE,  // pattern mode, no key pressed
+        S_PAT_DOWN,  // pattern mode, keycode pressed
+        S_PAT_READY, // pattern ready, wait Handled()
+        S_MAX
+    };
+
+    enum input_e : uint8_t
+    {
+        IN_TICK,       // stable keycode unchanged
+        IN_DOWN,       // other keycode pressed
+        IN_AGAIN,      // same keycode pressed again after release
+        IN_UP,         // all keys released
+        IN_UP_FULL,    // all keys released, pattern buffer full
+        IN_UP_PATTERN, // pattern key released after pattern min..max ms
+        IN_CLICK,      // keys released longer than double click
+        IN_TIMEOUT,    // no pattern key within pattern timeout
+        IN_MAX
+    };
+
+    enum action_e : uint8_t
+    {
+        ACT_NONE,
+        ACT_PRESS,
+        ACT_REPLACE,
+        ACT_AGAIN,
+        ACT_HOLD,
+        ACT_RELEASE,
+        ACT_READY,
+        ACT_PATTERN_START,
+        ACT_PATTERN_RUN,
+        ACT_PATTERN_ADD,
+        ACT_PATTERN_FULL,
+        ACT_PATTERN_END,
+        ACT_PATTERN_TIMEOUT,
+        ACT_MAX
+    };
+
+    struct transition_t
+    {
+        state_e next;
+        action_e action;
+    };
+
+    static const transition_t _transitions[S_MAX][IN_MAX];
+
+    input_e nextInput();
+    void doAction(action_e action);
+    void hold();
+    void patternAdd();
+    uint8_t readKeys();
+    uint8_t readTouch();
+    bool textOutput();
+    void report(MTkbdReport::type_e type);
+    void flushReport();
+#if MTKBD_SNAPSHOT
+    void publish();
+#endif
+    void resetEvent();
+    void setReady();
     void clearPattern();
     void clearData();
     char hex_digit(uint8_t v);
@@ -100,46 +230,66 @@ private:
     void patternReady();
     void debug(uint8_t id = 0, uint32_t dly = 50);
 
-    bool _initError = false;               // initialize error -> don't loop
-    uint8_t _numKeys;                      // number of key pins
-    uint8_t *_keys;                        // array of key pins
-                                           //
-    uint8_t _patternKeyCode = 0;           // pattern key
-    char *_pattern;                        // saved key pattern
-    String _patternString = "";            // Pattern as string
-    uint8_t _patternPos = 0;               // pattern curscor pos
-                                           //
-    uint8_t _rawKeyCode = 0;               // read key code before stable
-    uint8_t _lastRawKeyCode = 0;           // last read key code before stable
-    bool _keyDown = false;                 // key is pressed
-    uint8_t _keyCode = 0;                  // pressed key code after stable
-    uint8_t _lastKeyCode = 0;              // last pressed key code
-                                           //
-    uint8_t _repeatNr = 0;                 // nr of same keycode pressed within double click
-                                           //
-    bool _activeLow = true;                // key pins are active low
-    bool _keyCodeValid = false;            // keys pressed are valid >> stable after bounce time
-    bool _keyCodeReady = false;            // keycode are ready for handle >> stable for > doubleclickms
-    pattern_e _patternMode = PATTERN_NONE; // kbd is in pattern mode 0=NONE, 1=START, 2=RUN, 3=END
-    bool _waitHandled = false;             // wait until kbd handled req to call handled()
     uint32_t _rawReadMS = 0;               // keys read ms
     uint32_t _stableMS = 0;                // ms when keys are stable (no bounce)
     uint32_t _patternModeMS = 0;           // ms when pattern mode start or last key change
     uint32_t _firstPressMS = 0;            // stable keycode first pressed
-    uint32_t _lastPressMS = 0;             // stable keycode last pressed if same as before
-    uint32_t _releaseMS = 0;               // key released
-    uint32_t _durationMS = 0;              // duration of keycode pressed
-    uint32_t _lastInfoMS;                  // last time info was shown
+    uint32_t _durationMS = 0;              // duration of keycode pressed, first press to release when released
+    uint32_t _lastInfoMS = 0;              // last time info was shown
+    uint32_t _patternTimeout = 30000;      // timeout if no key pressed to exit pattern mode
+#if MTKBD_SNAPSHOT
+    uint32_t _eventSeq = 0;                // serial of the last event ready to handle, never 0 once set
+#endif
                                            //
     uint32_t _bounceMS = 50;               // bouce time before keycode become valid
     uint32_t _doubleClickMS = 300;         // double click time before keycode become ready to handle
     uint32_t _infoResponse = 500;          // timeout for display key duration
     uint32_t _patternMinMS = 2500;         // min timeout before start pattern mode
     uint32_t _patternMaxMS = 5000;         // max timeout to start pattern mode
-    uint32_t _patternTimeout = 30000;      // timeout if no key pressed to exit pattern mode
+                                           //
+    char *_pattern = nullptr;              // saved key pattern
+    uint32_t *_touchBaseline = nullptr;    // array of pad baselines, fixed point Q24.8
+    uint8_t *_reportBuf = nullptr;         // binary records of one loop, written at once
+    uint16_t _reportSize = 0;              // size of _reportBuf
+    uint16_t _reportLen = 0;               // bytes in _reportBuf
+                                           //
+    uint8_t _keys[8];                      // array of key pins
+    uint8_t _numKeys = 0;                  // number of key pins
+    uint8_t _patternKeyCode = 0;           // pattern key
+    uint8_t _patternPos = 0;               // pattern curscor pos
     uint8_t _maxPatternLength = 8;         // max length of pattern buffer
+    uint8_t _rawKeyCode = 0;               // read key code before stable
+    uint8_t _lastRawKeyCode = 0;           // last read key code before stable
+    uint8_t _stableKeyCode = 0;            // raw key code after bounce time
+    uint8_t _keyCode = 0;                  // pressed key code after stable
+    uint8_t _repeatNr = 0;                 // nr of same keycode pressed within double click
+    state_e _state = S_IDLE;               // state of Loop() state machine
+    pattern_e _patternMode = PATTERN_NONE; // kbd is in pattern mode 0=NONE, 1=START, 2=RUN, 3=END
+    report_e _reportMode = REPORT_TEXT;    // OUTPORT gets info lines or binary records
+    uint8_t _reportSeq = 0;                // sequence number of next record
+    uint8_t _touchState = 0;               // touch pads pressed after hysteresis
+    uint8_t _touchPressQ8 = 51;            // pad pressed when value moves this fraction of 256 away from baseline
+    uint8_t _touchReleaseQ8 = 25;          // pad released when value moves back within this fraction of 256
+    uint8_t _touchFilterShift = 6;         // baseline IIR weight 1/2^shift per scan
+                                           //
+    bool _keyDown : 1;                     // stable key code is pressed
+    bool _keyCodeValid : 1;                // keys pressed are valid >> stable after bounce time
+    bool _keyCodeReady : 1;                // keycode are ready for handle >> stable for > doubleclickms
+    bool _snapDirty : 1;                   // event fields changed since last publish()
+    bool : 0;                              // flags above are written by Loop(), below by Begin() and setters:
+                                           // separate bytes, a setter on another core can't overwrite Loop() state
+    bool _initError : 1;                   // initialize error -> don't loop
+    bool _activeLow : 1;                   // key pins are active low
+    bool _waitHandled : 1;                 // wait until kbd handled req to call handled()
+    bool _showLongPressInfo : 1;           // show info when key is long pressed every _infoResponse
+    bool _showPatternInfo : 1;             // show info when in pattern mode
+    bool _touchMode : 1;                   // keys are capacitive touch pads -> touchRead()
+#if MTKBD_SNAPSHOT
                                            //
-    bool _showLongPressInfo = true;        // show info when key is long pressed every _infoResponse
-    bool _showPatternInfo = true;          // show info when in pattern mode
+    static const uint8_t SNAP_WORDS = (sizeof(event_t) + 3) / 4;
+    std::atomic<uint32_t> _snapSeq{0};     // seqlock, odd while publish() writes
+    std::atomic<uint32_t> _snapData[SNAP_WORDS] = {}; // last published event_t
+    std::atomic<uint32_t> _handledReq{0};  // Handled(seq) from another core, checked at start of Loop()
+#endif
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,266 @@
+/*
+ * KEY HANDLING LIBRARY - binary event report
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Marco Tinner, MT Consulting  ---  All right reserved. ---
+ *                    info@marcotinner.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * NO commercial use without prior permit by copyright owner.
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Plain C++ without Arduino dependencies, so the same file encodes on the
+// board and decodes on the host.
+//
+// Frame: SYNC | LEN | payload[LEN] | CRC16 lo | CRC16 hi
+// Payload: seq | type | keycode | repeat | duration ms (u32 le) | timestamp ms (u32 le) | pattern chars (hex digits)
+// Only pattern records carry pattern chars.
+// CRC16-CCITT (poly 0x1021, init 0xFFFF) over LEN and payload.
+
+#ifndef MTKBD_REPORT_H
+#define MTKBD_REPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MTKBD_REPORT_SYNC 0xA5
+#define MTKBD_REPORT_HEADER 12                                // payload bytes before pattern chars
+#define MTKBD_REPORT_OVERHEAD 4                               // sync + len + crc16
+#define MTKBD_REPORT_MAX_PATTERN (255 - MTKBD_REPORT_HEADER) // pattern chars fitting in one record
+
+class MTkbdReport
+{
+public:
+    enum type_e : uint8_t
+    {
+        EVT_NONE,
+        EVT_KEY,       // keycode ready to handle
+        EVT_PATTERN,   // pattern ready to handle
+        EVT_LONGPRESS, // key still pressed, sent every info response ms
+        EVT_MAX
+    };
+
+    struct Event
+    {
+        uint8_t seq;
+        type_e type;
+        uint8_t keyCode;
+        uint8_t repeat;
+        uint32_t durationMS;
+        uint32_t timestampMS;
+        uint8_t patternLength;
+        char pattern[MTKBD_REPORT_MAX_PATTERN + 1]; // '\0' terminated
+    };
+
+    /// @brief CRC16-CCITT
+    /// @param data bytes
+    /// @param len number of bytes
+    /// @param crc start value to continue a crc
+    /// @return crc
+    static uint16_t Crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF)
+    {
+        while (len--)
+        {
+            crc ^= (uint16_t)(*data++) << 8;
+            for (uint8_t bit = 0; bit < 8; bit++)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        return crc;
+    }
+
+    /// @brief encode one event record into buf
+    /// @param buf destination
+    /// @param size free bytes in buf
+    /// @param pattern pattern chars, may be nullptr if patternLength is 0
+    /// @param patternLength number of pattern chars, cut to MTKBD_REPORT_MAX_PATTERN
+    /// @return bytes written, 0 if buf is too small
+    static size_t Encode(uint8_t *buf, size_t size, uint8_t seq, type_e type, uint8_t keyCode, uint8_t repeat,
+                         uint32_t durationMS, uint32_t timestampMS, const char *pattern = nullptr, uint8_t patternLength = 0)
+    {
+        if (patternLength > MTKBD_REPORT_MAX_PATTERN)
+            patternLength = MTKBD_REPORT_MAX_PATTERN;
+        uint8_t len = MTKBD_REPORT_HEADER + patternLength;
+        if (size < (size_t)len + MTKBD_REPORT_OVERHEAD)
+            return 0;
+
+        uint8_t *p = buf;
+        *p++ = MTKBD_REPORT_SYNC;
+        *p++ = len;
+        *p++ = seq;
+        *p++ = type;
+        *p++ = keyCode;
+        *p++ = repeat;
+        p = put32(p, durationMS);
+        p = put32(p, timestampMS);
+        for (uint8_t idx = 0; idx < patternLength; idx++)
+            *p++ = (uint8_t)pattern[idx];
+        uint16_t crc = Crc16(buf + 1, len + 1);
+        *p++ = crc & 0xFF;
+        *p++ = crc >> 8;
+        return p - buf;
+    }
+
+    /// @brief feed one received byte into the decoder
+    /// @param b byte
+    /// @return true if a complete record with valid crc is available -> GetEvent(), then Next() until false
+    bool Decode(uint8_t b)
+    {
+        _buf[_len++] = b;
+        return Next();
+    }
+
+    /// @brief decode the next record already received
+    /// A corrupted frame is dropped from its SYNC byte only, the search for the next frame
+    /// restarts at the byte after it, so records received behind a broken LEN are not lost.
+    /// @return true if another record is available -> GetEvent()
+    bool Next()
+    {
+        while (_len)
+        {
+            if (_buf[0] != MTKBD_REPORT_SYNC)
+            {
+                uint16_t pos = 1;
+                while (pos < _len && _buf[pos] != MTKBD_REPORT_SYNC)
+                    pos++;
+                _skipped += pos;
+                drop(pos);
+                continue;
+            }
+            frame_e have = checkFrame();
+            if (have == FRAME_PARTIAL)
+                return false;
+            if (have == FRAME_OK)
+            {
+                parse();
+                drop(_buf[1] + MTKBD_REPORT_OVERHEAD);
+                return true;
+            }
+            if (have == FRAME_CRC)
+                _crcErrors++;
+            else
+                _frameErrors++;
+            _skipped++;
+            drop(1);
+        }
+        return false;
+    }
+
+    /// @brief last decoded event
+    /// @return event
+    const Event &GetEvent() const { return _event; }
+
+    /// @brief number of records dropped because of a crc mismatch
+    uint32_t GetCrcErrors() const { return _crcErrors; }
+
+    /// @brief number of records missing in the sequence numbers
+    uint32_t GetLostRecords() const { return _lost; }
+
+    /// @brief number of frames dropped because of an implausible length, type or pattern char
+    uint32_t GetFrameErrors() const { return _frameErrors; }
+
+    /// @brief number of bytes skipped while searching for a frame start
+    uint32_t GetSkippedBytes() const { return _skipped; }
+
+private:
+    enum frame_e : uint8_t
+    {
+        FRAME_PARTIAL, // plausible so far, wait for more bytes
+        FRAME_OK,
+        FRAME_CRC,     // complete, crc mismatch
+        FRAME_INVALID  // length, type or pattern char impossible
+    };
+
+    static uint8_t *put32(uint8_t *p, uint32_t v)
+    {
+        *p++ = v & 0xFF;
+        *p++ = (v >> 8) & 0xFF;
+        *p++ = (v >> 16) & 0xFF;
+        *p++ = v >> 24;
+        return p;
+    }
+
+    static uint32_t get32(const uint8_t *p)
+    {
+        return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    // check the frame starting with SYNC at _buf[0] as far as received
+    frame_e checkFrame() const
+    {
+        if (_len < 2)
+            return FRAME_PARTIAL;
+        uint8_t len = _buf[1];
+        if (len < MTKBD_REPORT_HEADER)
+            return FRAME_INVALID;
+        if (_len < 4)
+            return FRAME_PARTIAL;
+        uint8_t type = _buf[3];
+        if (type == EVT_NONE || type >= EVT_MAX || (type != EVT_PATTERN && len != MTKBD_REPORT_HEADER))
+            return FRAME_INVALID;
+        uint16_t end = len + 2; // end of payload
+        for (uint16_t pos = 2 + MTKBD_REPORT_HEADER; pos < end && pos < _len; pos++)
+            if (!isHex(_buf[pos]))
+                return FRAME_INVALID;
+        if (_len < end + 2)
+            return FRAME_PARTIAL;
+        uint16_t crc = _buf[end] | (uint16_t)_buf[end + 1] << 8;
+        return Crc16(_buf + 1, len + 1) == crc ? FRAME_OK : FRAME_CRC;
+    }
+
+    static bool isHex(uint8_t c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    void drop(uint16_t n)
+    {
+        _len -= n;
+        memmove(_buf, _buf + n, _len);
+    }
+
+    void parse()
+    {
+        const uint8_t *p = _buf + 2;
+        if (_synced && p[0] != (uint8_t)(_event.seq + 1))
+            _lost += (uint8_t)(p[0] - _event.seq - 1);
+        _synced = true;
+        _event.seq = p[0];
+        _event.type = (type_e)p[1];
+        _event.keyCode = p[2];
+        _event.repeat = p[3];
+        _event.durationMS = get32(p + 4);
+        _event.timestampMS = get32(p + 8);
+        _event.patternLength = _buf[1] - MTKBD_REPORT_HEADER;
+        for (uint8_t idx = 0; idx < _event.patternLength; idx++)
+            _event.pattern[idx] = (char)p[MTKBD_REPORT_HEADER + idx];
+        _event.pattern[_event.patternLength] = '\0';
+    }
+
+    uint8_t _buf[MTKBD_REPORT_OVERHEAD + 255]; // received bytes from the current frame start on
+    uint16_t _len = 0;
+    bool _synced = false;
+    uint32_t _crcErrors = 0;
+    uint32_t _frameErrors = 0;
+    uint32_t _lost = 0;
+    uint32_t _skipped = 0;
+    Event _event = {};
+};
+#endif